@@ -4,7 +4,7 @@
 #include "../stb_image/stb_image_write.h"
 #include "../stb_image/stb_image.h"
 #include <vector>
-#include "filtered_data.h"
+#include "../lib/threshold_context.h"
 
 
 
@@ -24,55 +24,27 @@ int main() {
     // Print image information
     std::cout << "Image width: " << width << ", height: " << height << ", channels: " << channels << std::endl;
     
-    // Store information in 2d vector --> max_values[column][pixel intensity, y value of the pixel]
-    std::vector<std::vector<int> > max_values(width, std::vector<int>(2));
+    ThresholdContext ctx(width, height, channels);
 
-    // Access pixel values
-    for (int x = 0; x < width; ++x) {
-        for (int y = 0; y < height; ++y) {
-            // Calculate index in the 1D array
-            int index = (y * width + x) * channels;
-            if (max_values[x][0] < (int)image[index]){
-                max_values[x][0] = (int)image[index];
-                max_values[x][1] = y;
-            }    
-        }
-    }
-    
-    // Find average y value for max intensity in each column
-    for (int x = 0; x < width; ++x) {
-        int sum = 0;
-        int divisor = 0;
-        for (int y = 0; y < height; ++y) {
-            if (image[(y * width + x)*channels] == max_values[x][0]){
-                sum += y;
-                divisor++;
-            }
-        }
-        max_values[x][1] = sum/divisor;
-    }
-
-    std::vector<double> x_data(width);
-    std::vector<std::vector<int> > y_data;
-
-    for (int i = 0; i < width; ++i) {
-        x_data[i] = i;
-        std::vector<int> temp_row;
-        temp_row.push_back(max_values[i][0]);
-        temp_row.push_back(max_values[i][1]);
-        y_data.push_back(temp_row);
-    }
+    // For each column store the max pixel intensity and the average y value where it occurs
+    column_peaks(ctx, image, width, height, channels);
 
-    // Perform linear regression
+    // Perform linear regression, dropping columns whose peak intensity is an outlier
     double slope, intercept;
-    FilteredData filteredData = linearRegression(x_data, y_data, slope, intercept);
+    double zscore_threshold = 2.0; // can change to include more outliers
+    if (!fit_line(ctx, width, zscore_threshold, slope, intercept)) {
+        std::cerr << "Not enough points to fit a line" << std::endl;
+        stbi_image_free(image);
+        return -1;
+    }
     std::cout << "Slope: " << slope << ", intercept: " << intercept << std::endl;
 
     // Plot max_values of each column
-    for (int x = 0; x < filteredData.filtered_x.size(); ++x) {
-        image[(int)(filteredData.filtered_y[x] * width +  filteredData.filtered_x[x]) * channels] = 255; // Set pixel to red
-        image[(int)(filteredData.filtered_y[x] * width +  filteredData.filtered_x[x]) * channels + 1] = 0;
-        image[(int)(filteredData.filtered_y[x] * width +  filteredData.filtered_x[x]) * channels + 2] = 0;
+    for (int i = 0; i < ctx.n_filtered; ++i) {
+        int index = (int)(ctx.filtered_y[i] * width + ctx.filtered_x[i]) * channels;
+        image[index] = 255; // Set pixel to red
+        image[index + 1] = 0;
+        image[index + 2] = 0;
     }
 
     // Plot the regression line
@@ -4,63 +4,12 @@
 #include <iostream>
 #include "../stb_image/stb_image_write.h"
 #include "../stb_image/stb_image.h"
-#include "kmeans.h"
+#include "../lib/threshold_context.h"
 #include <vector>
 #include <cmath>
+#include <cstdio>
+#include <algorithm>
 
-int MAX_INTENSITY = 255;
-
-// Maximize variance between classes, by iterating over each part of the intensity histogram
-// find intensity value that acts as a threshold to maximize variance between the two classes
-int otsu_threshold(const std::vector<unsigned char>& sorted_pixels, int width, int height) {
-    long int N = width * height;
-    int threshold = 0;
-    float sum = 0;
-    float sumB = 0;
-    int q1 = 0;
-    int q2 = 0;
-    float varMax = 0;
-    std::vector<float> hist(256, 0);
-
-    // Compute histogram
-    for (int i = 0; i < N; i++) {
-        int value = (int) sorted_pixels[i];
-        hist[value]++;
-    }
-
-    // Auxiliary value for computing m2
-    for (int i = 0; i <= MAX_INTENSITY; i++){
-      sum += i * ((int)hist[i]);
-    }
-
-    for (int i = 0 ; i <= MAX_INTENSITY ; i++) {
-      // Update q1
-      q1 += hist[i]; // pixels up till i hist distribution
-      if (q1 == 0)
-        continue;
-      // Update q2
-      q2 = N - q1; // rest of the pixels
-
-      if (q2 == 0) // go until you cover whole histogram
-        break;
-      // Update m1 and m2 --> calculate the mean intensity, weight contribution of each intensity to total sum
-      // --> to calculate the mean 
-      sumB += (float) (i * ((int)hist[i]));
-      float m1 = sumB / q1;
-      float m2 = (sum - sumB) / q2;
-
-      // Update the between class variance
-      float varBetween = (float) q1 * (float) q2 * (m1 - m2) * (m1 - m2);
-
-      // Update the threshold if necessary
-      if (varBetween > varMax) {
-        varMax = varBetween;
-        threshold = i;
-      }
-    }
-    return threshold;
-}
-    
 void sort_row_pixels(std::vector<unsigned char>& pixels, int width, int height) {
     for (int y = 0; y < height; ++y) {
         std::vector<unsigned char>::iterator row_start = pixels.begin() + y * width;
@@ -73,42 +22,27 @@ void sort_image(std::vector<unsigned char>& pixels, int width, int height){
     std::sort(pixels.begin(), pixels.end(), std::greater<unsigned char>());
 }
 
-void manual_threshold(unsigned char* image, int width, int height, int channels){
-    std::vector<unsigned char> dark_areas_green(image, image + width * height * channels);
-    
-    for (int i = 0; i < width * height; ++i) {
-        if (dark_areas_green[3*i+1] < 55){
-            dark_areas_green[3*i] = 0;
-            dark_areas_green[3*i+1] = 0;
-            dark_areas_green[3*i+2] = 0;
-        }
-    }
-
-    stbi_write_png("dark_areas_green_manual.png", width, height, 3, dark_areas_green.data(), width*channels);
-
-    std::vector<unsigned char> dark_areas_red(image, image + width * height * channels);
-    for (int i = 0; i < width * height; ++i) {
-        if (dark_areas_red[3*i] < 40){
-            dark_areas_red[3*i] = 0;
-            dark_areas_red[3*i+1] = 0;
-            dark_areas_red[3*i+2] = 0;
-        }
-    }
+// Write the three dark area masks for a pair of red/green thresholds:
+// green below green_threshold, red below red_threshold, and dark red + light green
+void write_masks(ThresholdContext& ctx, unsigned char* image, int width, int height, int channels,
+                 int red_threshold, int green_threshold, const char* suffix) {
+    char name[64];
 
-    stbi_write_png("dark_areas_red_manual.png", width, height, 3, dark_areas_red.data(), width*channels);
+    mask_pixels(ctx, image, width, height, channels, [&](const unsigned char* p) { return p[1] >= green_threshold; });
+    snprintf(name, sizeof(name), "dark_areas_green%s.png", suffix);
+    stbi_write_png(name, width, height, channels, ctx.mask.data(), width*channels);
 
+    mask_pixels(ctx, image, width, height, channels, [&](const unsigned char* p) { return p[0] >= red_threshold; });
+    snprintf(name, sizeof(name), "dark_areas_red%s.png", suffix);
+    stbi_write_png(name, width, height, channels, ctx.mask.data(), width*channels);
 
-    std::vector<unsigned char> dark_red_light_green(image, image + width * height * channels);
-    for (int i = 0; i < width * height; ++i) {
-        if (!(dark_red_light_green[3*i] < 40 && dark_red_light_green[3*i+1]>55)){
-            dark_red_light_green[3*i] = 0;
-            dark_red_light_green[3*i+1] = 0;
-            dark_red_light_green[3*i+2] = 0;
-        }
-    }
-
-    stbi_write_png("dark_red_light_green_manual.png", width, height, 3, dark_red_light_green.data(), width*channels);
+    mask_pixels(ctx, image, width, height, channels, [&](const unsigned char* p) { return p[0] < red_threshold && p[1] > green_threshold; });
+    snprintf(name, sizeof(name), "dark_red_light_green%s.png", suffix);
+    stbi_write_png(name, width, height, channels, ctx.mask.data(), width*channels);
+}
 
+void manual_threshold(ThresholdContext& ctx, unsigned char* image, int width, int height, int channels){
+    write_masks(ctx, image, width, height, channels, 40, 55, "_manual");
 }
 
 
@@ -146,6 +80,9 @@ int main() {
     // Print image information
     std::cout << "Image width: " << gr_width << ", height: " << gr_height << ", channels: " << gr_channels << std::endl;
 
+    // All scratch memory for the thresholding is allocated here, once
+    ThresholdContext ctx(gr_width, gr_height, 3);
+
     std::vector<unsigned char> gr_pixels(grayscale, grayscale + gr_width * gr_height * gr_channels);
 
     // Sort grayscale by row descending
@@ -156,7 +93,7 @@ int main() {
     sort_image(gr_pixels, gr_width, gr_height);
     stbi_write_jpg("sorted_grayscale.jpg", gr_width, gr_height, gr_channels, gr_pixels.data(), gr_width * gr_channels);
 
-    int threshold = otsu_threshold(gr_pixels,gr_width,gr_height);
+    int threshold = otsu_threshold(ctx, gr_pixels.data(), gr_width * gr_height);
     std::cout << "Otsu grayscale: " << threshold << std::endl;
 
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -170,19 +107,21 @@ int main() {
     // Check if the image was loaded successfully
     if (!image) {
         std::cerr << "Failed to load image" << std::endl;
+        stbi_image_free(grayscale);
+        return -1;
+    }
+    if (!ctx.fits(width, height, channels)) {
+        std::cerr << "RGB image is " << width << "x" << height << ", larger than the grayscale one" << std::endl;
+        stbi_image_free(image);
+        stbi_image_free(grayscale);
         return -1;
     }
 
     std::cout << "Image width: " << width << ", height: " << height << ", channels: " << channels << std::endl;
 
-    std::vector<unsigned char> pixels(image, image + width * height * channels);
-
-    std::vector<unsigned char> red_channel, green_channel, blue_channel;
-    for (size_t i = 0; i < pixels.size(); i += 3) {
-        red_channel.push_back(pixels[i]);
-        green_channel.push_back(pixels[i + 1]);
-        blue_channel.push_back(pixels[i + 2]);
-    }
+    std::vector<unsigned char> red_channel(width * height), green_channel(width * height);
+    extract_channel(image, width * height, channels, 0, red_channel.data());
+    extract_channel(image, width * height, channels, 1, green_channel.data());
 
     sort_row_pixels(green_channel, width, height);
     sort_row_pixels(red_channel,width,height);
@@ -196,184 +135,57 @@ int main() {
     stbi_write_png("image_sorted_green.png", width, height, 1, green_channel.data(), width);
     stbi_write_png("image_sorted_red.png", width, height, 1, red_channel.data(), width);
 
-    int green_threshold = otsu_threshold(green_channel, width, height);
+    int green_threshold = otsu_threshold(ctx, green_channel.data(), width * height);
     std::cout << "Otsu green: " << green_threshold << std::endl;
-    int red_threshold = otsu_threshold(red_channel, width, height);
+    int red_threshold = otsu_threshold(ctx, red_channel.data(), width * height);
     std::cout << "Otsu red: " << red_threshold << std::endl;
 
-    std::vector<unsigned char> dark_areas_green(image, image + width * height * channels);
-    for (int i = 0; i < width * height; ++i) {
-        if (dark_areas_green[3*i+1] < green_threshold){
-            dark_areas_green[3*i] = 0;
-            dark_areas_green[3*i+1] = 0;
-            dark_areas_green[3*i+2] = 0;
-        }
-    }
-    stbi_write_png("dark_areas_green.png", width, height, 3, dark_areas_green.data(), width*channels);
-
-
-    std::vector<unsigned char> dark_areas_red(image, image + width * height * channels);
-    for (int i = 0; i < width * height; ++i) {
-        if (dark_areas_red[3*i] < red_threshold){
-            dark_areas_red[3*i] = 0;
-            dark_areas_red[3*i+1] = 0;
-            dark_areas_red[3*i+2] = 0;
-        }
-    }
-    stbi_write_png("dark_areas_red.png", width, height, 3, dark_areas_red.data(), width*channels);
-
-
-    std::vector<unsigned char> dark_red_light_green(image, image + width * height * channels);
-    for (int i = 0; i < width * height; ++i) {
-        if (!(dark_red_light_green[3*i] < red_threshold && dark_red_light_green[3*i+1]>green_threshold)){
-            dark_red_light_green[3*i] = 0;
-            dark_red_light_green[3*i+1] = 0;
-            dark_red_light_green[3*i+2] = 0;
-        }
-    }
-    stbi_write_png("dark_red_light_green.png", width, height, 3, dark_red_light_green.data(), width*channels);
+    write_masks(ctx, image, width, height, channels, red_threshold, green_threshold, "");
 
     /////////////////////////////////////////////////////////////////
     // Using Otsu threshold from grayscale image on rgb image      //
     /////////////////////////////////////////////////////////////////
 
-    std::vector<unsigned char> dark_areas_green_gr(image, image + width * height * channels);
-    for (int i = 0; i < width * height; ++i) {
-        if (dark_areas_green_gr[3*i+1] < threshold){
-            dark_areas_green_gr[3*i] = 0;
-            dark_areas_green_gr[3*i+1] = 0;
-            dark_areas_green_gr[3*i+2] = 0;
-        }
-    }
-    stbi_write_png("dark_areas_green_gr.png", width, height, 3, dark_areas_green_gr.data(), width*channels);
-
-
-    std::vector<unsigned char> dark_areas_red_gr(image, image + width * height * channels);
-    for (int i = 0; i < width * height; ++i) {
-        if (dark_areas_red_gr[3*i] < threshold){
-            dark_areas_red_gr[3*i] = 0;
-            dark_areas_red_gr[3*i+1] = 0;
-            dark_areas_red_gr[3*i+2] = 0;
-        }
-    }
-    stbi_write_png("dark_areas_red_gr.png", width, height, 3, dark_areas_red_gr.data(), width*channels);
-
-
-    std::vector<unsigned char> dark_red_light_green_gr(image, image + width * height * channels);
-    for (int i = 0; i < width * height; ++i) {
-        if (!(dark_red_light_green_gr[3*i] < threshold && dark_red_light_green_gr[3*i+1]>threshold)){
-            dark_red_light_green_gr[3*i] = 0;
-            dark_red_light_green_gr[3*i+1] = 0;
-            dark_red_light_green_gr[3*i+2] = 0;
-        }
-    }
-    stbi_write_png("dark_red_light_green_gr.png", width, height, 3, dark_red_light_green_gr.data(), width*channels);
-
-
+    write_masks(ctx, image, width, height, channels, threshold, threshold, "_gr");
     
     /////////////////////////////////////////////////////////////////
     // KMEANS                                                      //
     /////////////////////////////////////////////////////////////////
-    
-    std::vector<Point> red_points;
-    for (int i = 0; i < width * height; ++i) {
-        Point p;
-        p.intensity = red_channel[i]; // Assuming RGB order
-        red_points.push_back(p);
-    }
-
-    std::vector<Point> green_points;
-    for (int i = 0; i < width * height; ++i) {
-        Point p;
-        p.intensity = green_channel[i]; // Assuming RGB order
-        green_points.push_back(p);
-    }
 
     // Number of clusters
     int k = 2;
 
-    // red_centroids and red_assignments
-    std::vector<Point> red_centroids;
-    std::vector<int> red_assignments;
-    std::vector<Point> green_centroids;
-    std::vector<int> green_assignments;
-
     // Maximum iterations
     int max_iterations = 100;
 
-    // Perform k-means clustering
-    kMeans(red_points, k, red_centroids, red_assignments, max_iterations);
-    kMeans(green_points, k, green_centroids, green_assignments, max_iterations);
-    int red_intensity_threshold = -1;
-    int green_intensity_threshold = -1;
-
-    // Generate a new image using the cluster red_centroids
-    for (int i = 0; i < k; ++i) {
-        std::vector<int> result = getClusterStats(red_points, red_assignments, i);
-        int intensity = result[0];
-        int count = result[1];
-        int min_intensity = result[2];
-        int max_intensity = result[3];
-        red_intensity_threshold = std::max(red_intensity_threshold, min_intensity);
-        std::cout << "Cluster " << i << " intensity: " << intensity << " (count: " << count << ") " << "Min intensity: " << min_intensity << " Max intensity: " << max_intensity << std::endl;
-    }
+    // The context only keeps the assignments of the last run, so save each cluster image right after its run
+    unsigned char* outputData = new unsigned char[width * height];
 
+    int red_intensity_threshold = kmeans_threshold(ctx, red_channel.data(), width * height, k, max_iterations);
     for (int i = 0; i < k; ++i) {
-        std::vector<int> result = getClusterStats(green_points, green_assignments, i);
-        int intensity = result[0];
-        int count = result[1];
-        int min_intensity = result[2];
-        int max_intensity = result[3];
-        green_intensity_threshold = std::max(green_intensity_threshold, min_intensity);
-        std::cout << "Cluster " << i << " intensity: " << intensity << " (count: " << count << ") " << "Min intensity: " << min_intensity << " Max intensity: " << max_intensity << std::endl;
+        const ClusterStats& stats = ctx.clusters[i];
+        std::cout << "Cluster " << i << " intensity: " << stats.intensity << " (count: " << stats.count << ") " << "Min intensity: " << stats.min_intensity << " Max intensity: " << stats.max_intensity << std::endl;
     }
-
-    // Save the resulting image
-    unsigned char* outputData = new unsigned char[width * height];
     for (int i = 0; i < width * height; ++i) {
-        outputData[i] = red_centroids[red_assignments[i]].intensity;
+        outputData[i] = ctx.centroids[ctx.assignments[i]];
     }
     stbi_write_png("output_image_red.png", width, height, 1, outputData, width);
-    for (int i = 0; i < width * height; ++i) {
-        outputData[i] = green_centroids[green_assignments[i]].intensity;
-    }
-    stbi_write_png("output_image_green.png", width, height, 1, outputData, width);
 
-
-    std::vector<unsigned char> dark_areas_green_km(image, image + width * height * channels);
-    for (int i = 0; i < width * height; ++i) {
-        if (dark_areas_green_km[3*i+1] < green_intensity_threshold){
-            dark_areas_green_km[3*i] = 0;
-            dark_areas_green_km[3*i+1] = 0;
-            dark_areas_green_km[3*i+2] = 0;
-        }
+    int green_intensity_threshold = kmeans_threshold(ctx, green_channel.data(), width * height, k, max_iterations);
+    for (int i = 0; i < k; ++i) {
+        const ClusterStats& stats = ctx.clusters[i];
+        std::cout << "Cluster " << i << " intensity: " << stats.intensity << " (count: " << stats.count << ") " << "Min intensity: " << stats.min_intensity << " Max intensity: " << stats.max_intensity << std::endl;
     }
-    stbi_write_png("dark_areas_green_km.png", width, height, 3, dark_areas_green_km.data(), width*channels);
-
-
-    std::vector<unsigned char> dark_areas_red_km(image, image + width * height * channels);
     for (int i = 0; i < width * height; ++i) {
-        if (dark_areas_red_km[3*i] < red_intensity_threshold){
-            dark_areas_red_km[3*i] = 0;
-            dark_areas_red_km[3*i+1] = 0;
-            dark_areas_red_km[3*i+2] = 0;
-        }
+        outputData[i] = ctx.centroids[ctx.assignments[i]];
     }
-    stbi_write_png("dark_areas_red_km.png", width, height, 3, dark_areas_red_km.data(), width*channels);
-
+    stbi_write_png("output_image_green.png", width, height, 1, outputData, width);
+    delete[] outputData;
 
-    std::vector<unsigned char> dark_red_light_green_km(image, image + width * height * channels);
-    for (int i = 0; i < width * height; ++i) {
-        if (!(dark_red_light_green_km[3*i] < red_intensity_threshold && dark_red_light_green_km[3*i+1]>green_intensity_threshold)){
-            dark_red_light_green_km[3*i] = 0;
-            dark_red_light_green_km[3*i+1] = 0;
-            dark_red_light_green_km[3*i+2] = 0;
-        }
-    }
-    stbi_write_png("dark_red_light_green_km.png", width, height, 3, dark_red_light_green_km.data(), width*channels);
+    write_masks(ctx, image, width, height, channels, red_intensity_threshold, green_intensity_threshold, "_km");
 
-    manual_threshold(image, width, height, channels); 
+    manual_threshold(ctx, image, width, height, channels); 
 
     stbi_image_free(image);
     stbi_image_free(grayscale);
-}
\ No newline at end of file
+}
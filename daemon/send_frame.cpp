@@ -0,0 +1,109 @@
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+
+#include <iostream>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "../stb_image/stb_image_write.h"
+#include "../stb_image/stb_image.h"
+#include "../lib/frame_ring.h"
+
+// Example producer for threshold_daemon: load a png, hand it to the daemon, print the results
+// Usage: send_frame <shm name> <socket path> <image> <threshold|line> [mask output png]
+
+int main(int argc, char** argv) {
+    if (argc < 5) {
+        std::cerr << "Usage: " << argv[0] << " <shm name> <socket path> <image> <threshold|line> [mask output png]" << std::endl;
+        return -1;
+    }
+    bool line = std::strcmp(argv[4], "line") == 0;
+
+    int width, height, original_channels;
+    int channels = 3;
+    unsigned char* image = stbi_load(argv[3], &width, &height, &original_channels, channels);
+    if (!image) {
+        std::cerr << "Failed to load image" << std::endl;
+        return -1;
+    }
+
+    FrameRing ring;
+    if (!frame_ring_attach(argv[1], ring)) {
+        std::cerr << "Failed to attach to shared memory " << argv[1] << std::endl;
+        stbi_image_free(image);
+        return -1;
+    }
+    if ((uint32_t) width > ring.max_width || (uint32_t) height > ring.max_height || (uint32_t) channels > ring.max_channels) {
+        std::cerr << "Image is larger than the daemon's frames" << std::endl;
+        frame_ring_detach(ring);
+        stbi_image_free(image);
+        return -1;
+    }
+
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, argv[2], sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+        std::cerr << "Failed to connect to " << argv[2] << std::endl;
+        frame_ring_detach(ring);
+        stbi_image_free(image);
+        return -1;
+    }
+
+    // Other producers may share the ring, so claim a free slot before writing to it
+    long int claimed = frame_ring_claim(ring, 0);
+    if (claimed < 0) {
+        std::cerr << "No free slot in the ring" << std::endl;
+        close(fd);
+        frame_ring_detach(ring);
+        stbi_image_free(image);
+        return -1;
+    }
+    uint32_t index = (uint32_t) claimed;
+    FrameSlot* slot = frame_ring_slot(ring, index);
+    std::memcpy(frame_ring_pixels(slot), image, (size_t) width * height * channels);
+    slot->pipeline = line ? PIPELINE_LINE : PIPELINE_THRESHOLD;
+    slot->flags = 0;
+    slot->width = width;
+    slot->height = height;
+    slot->channels = channels;
+    slot->sequence = 0;
+    slot->state.store(SLOT_READY, std::memory_order_release);
+
+    uint32_t reply;
+    bool sent = send(fd, &index, sizeof(index), 0) == (ssize_t) sizeof(index) &&
+                recv(fd, &reply, sizeof(reply), MSG_WAITALL) == (ssize_t) sizeof(reply);
+    const char* error = nullptr;
+    if (!sent)
+        error = "Lost connection to the daemon";
+    else if (reply != index)
+        error = "Daemon rejected the request";
+    else if (slot->state.load(std::memory_order_acquire) != SLOT_DONE)
+        error = "Daemon failed to process the frame";
+    if (error) {
+        std::cerr << error << std::endl;
+        slot->state.store(SLOT_FREE, std::memory_order_release);
+        close(fd);
+        frame_ring_detach(ring);
+        stbi_image_free(image);
+        return -1;
+    }
+
+    const FrameResult& result = slot->result;
+    if (line) {
+        std::cout << "Slope: " << result.slope << ", intercept: " << result.intercept << " (" << result.n_filtered << " points)" << std::endl;
+    } else {
+        std::cout << "Otsu red: " << result.otsu_red << " Otsu green: " << result.otsu_green << std::endl;
+        std::cout << "Kmeans red: " << result.kmeans_red << " Kmeans green: " << result.kmeans_green << std::endl;
+        if (argc > 5)
+            stbi_write_png(argv[5], width, height, channels, frame_ring_mask(ring, slot), width * channels);
+    }
+    slot->state.store(SLOT_FREE, std::memory_order_release);
+
+    close(fd);
+    frame_ring_detach(ring);
+    stbi_image_free(image);
+    return 0;
+}
@@ -0,0 +1,264 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "../lib/threshold_context.h"
+#include "../lib/frame_ring.h"
+
+// Producer side checks of the daemon protocol, against a live threshold_daemon
+// Usage: test_daemon <path to threshold_daemon>
+// --> starts its own daemon on a private shm name / socket, runs every case, prints ok or the failed checks
+
+const char* SHM_NAME = "/otsu_test_daemon";
+const char* SOCKET_PATH = "/tmp/otsu_test_daemon.sock";
+const int WIDTH = 64;
+const int HEIGHT = 48;
+const int CHANNELS = 3;
+const int SLOTS = 3;
+
+const char* daemon_path;
+int failures = 0;
+
+void check(bool condition, const char* what) {
+    if (!condition) {
+        std::cerr << "FAIL: " << what << std::endl;
+        failures++;
+    }
+}
+
+// Start the daemon, returns its pid (the daemon may exit right away if it refuses to start)
+pid_t start_daemon(bool force) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, 1);
+        dup2(null_fd, 2);
+        std::string w = std::to_string(WIDTH), h = std::to_string(HEIGHT), n = std::to_string(SLOTS), c = std::to_string(CHANNELS);
+        if (force)
+            execl(daemon_path, daemon_path, "--force", SHM_NAME, SOCKET_PATH, w.c_str(), h.c_str(), n.c_str(), c.c_str(), (char*) nullptr);
+        else
+            execl(daemon_path, daemon_path, SHM_NAME, SOCKET_PATH, w.c_str(), h.c_str(), n.c_str(), c.c_str(), (char*) nullptr);
+        _exit(127);
+    }
+    return pid;
+}
+
+// -1 if the daemon is still running after timeout_ms, otherwise its exit status
+int wait_exit(pid_t pid, int timeout_ms) {
+    for (int i = 0; i < timeout_ms / 10; ++i) {
+        int status;
+        if (waitpid(pid, &status, WNOHANG) == pid)
+            return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        usleep(10000);
+    }
+    return -1;
+}
+
+int connect_daemon() {
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, SOCKET_PATH, sizeof(addr.sun_path) - 1);
+    for (int i = 0; i < 200; ++i) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) == 0)
+            return fd;
+        close(fd);
+        usleep(10000);
+    }
+    return -1;
+}
+
+bool attach(FrameRing& ring) {
+    for (int i = 0; i < 200; ++i) {
+        if (frame_ring_attach(SHM_NAME, ring))
+            return true;
+        usleep(10000);
+    }
+    return false;
+}
+
+// Send one slot index and wait for the reply, returns false if the connection broke
+bool request(int fd, uint32_t index, uint32_t& reply) {
+    return send(fd, &index, sizeof(index), 0) == (ssize_t) sizeof(index) &&
+           recv(fd, &reply, sizeof(reply), MSG_WAITALL) == (ssize_t) sizeof(reply);
+}
+
+void fill_slot(FrameSlot* slot, uint32_t pipeline, uint32_t flags, int width, int height) {
+    slot->pipeline = pipeline;
+    slot->flags = flags;
+    slot->width = width;
+    slot->height = height;
+    slot->channels = CHANNELS;
+    slot->state.store(SLOT_READY, std::memory_order_release);
+}
+
+void test_claim(FrameRing& ring) {
+    long int claimed[SLOTS];
+    for (int i = 0; i < SLOTS; ++i)
+        claimed[i] = frame_ring_claim(ring, 0);
+    check(claimed[0] == 0 && claimed[1] == 1 && claimed[2] == 2, "claims hand out distinct slots");
+    check(frame_ring_claim(ring, 0) == -1, "claim fails when every slot is taken");
+    for (int i = 0; i < SLOTS; ++i)
+        frame_ring_slot(ring, i)->state.store(SLOT_FREE, std::memory_order_release);
+}
+
+void test_pipelines(FrameRing& ring, int fd) {
+    uint32_t index = (uint32_t) frame_ring_claim(ring, 0);
+    FrameSlot* slot = frame_ring_slot(ring, index);
+    unsigned char* pixels = frame_ring_pixels(slot);
+    long int N = (long int) WIDTH * HEIGHT;
+    uint32_t reply;
+
+    // Threshold frame, compared with the library run locally
+    srand(1);
+    for (long int i = 0; i < N * CHANNELS; ++i)
+        pixels[i] = rand() % 256;
+    fill_slot(slot, PIPELINE_THRESHOLD, FLAG_KMEANS_MASK, WIDTH, HEIGHT);
+    check(request(fd, index, reply) && reply == index, "threshold frame is answered with its index");
+    check(slot->state.load() == SLOT_DONE, "threshold frame is SLOT_DONE");
+
+    ThresholdContext ctx(WIDTH, HEIGHT, CHANNELS, false);
+    std::vector<unsigned char> red(N);
+    extract_channel(pixels, N, CHANNELS, 0, red.data());
+    sort_descending(red.data(), N);
+    check(slot->result.otsu_red == otsu_threshold(ctx, red.data(), N), "daemon Otsu matches the library");
+    int kmeans_red = kmeans_threshold(ctx, red.data(), N, 2, 100);
+    check(slot->result.kmeans_red == kmeans_red, "daemon k-means matches the library");
+    bool mask_ok = true;
+    unsigned char* mask = frame_ring_mask(ring, slot);
+    for (long int i = 0; i < N; ++i) {
+        bool keep = pixels[i * 3] < kmeans_red && pixels[i * 3 + 1] > slot->result.kmeans_green;
+        mask_ok = mask_ok && mask[i * 3] == (keep ? pixels[i * 3] : 0);
+    }
+    check(mask_ok, "k-means mask is written into the slot");
+
+    // Blank frame on the line pipeline gives a flat line
+    std::memset(pixels, 0, N * CHANNELS);
+    fill_slot(slot, PIPELINE_LINE, 0, WIDTH, HEIGHT);
+    check(request(fd, index, reply) && reply == index && slot->state.load() == SLOT_DONE, "blank line frame is SLOT_DONE");
+    check(slot->result.slope == 0 && slot->result.n_filtered == WIDTH, "blank line frame keeps every column");
+
+    // Frames the pipelines cannot handle
+    fill_slot(slot, PIPELINE_THRESHOLD, 0, 1, 1);
+    check(request(fd, index, reply) && reply == index && slot->state.load() == SLOT_ERROR, "1x1 threshold frame is SLOT_ERROR");
+
+    slot->result.otsu_red = 99;
+    fill_slot(slot, PIPELINE_THRESHOLD, 0, WIDTH + 1, HEIGHT);
+    check(request(fd, index, reply) && reply == index && slot->state.load() == SLOT_ERROR, "oversized frame is SLOT_ERROR");
+    check(slot->result.otsu_red == 0, "rejected frame clears the old result");
+
+    fill_slot(slot, 7, 0, WIDTH, HEIGHT);
+    check(request(fd, index, reply) && reply == index && slot->state.load() == SLOT_ERROR, "unknown pipeline is SLOT_ERROR");
+
+    slot->state.store(SLOT_FREE, std::memory_order_release);
+}
+
+void test_invalid_requests(FrameRing& ring, int fd) {
+    uint32_t reply;
+    uint32_t index = (uint32_t) frame_ring_claim(ring, 0);
+    FrameSlot* slot = frame_ring_slot(ring, index);
+
+    check(request(fd, index, reply) && reply == FRAME_RING_REPLY_INVALID, "slot that is not ready is rejected");
+    check(slot->state.load() == SLOT_WRITING, "rejected request leaves the slot alone");
+    check(request(fd, 100000, reply) && reply == FRAME_RING_REPLY_INVALID, "out of range index is rejected");
+
+    // The daemon must not trust the shared header
+    FrameRingHeader saved = *ring.header;
+    ring.header->n_slots = 0x7fffffff;
+    ring.header->slot_stride = (uint64_t) 1 << 40;
+    check(request(fd, 100000, reply) && reply == FRAME_RING_REPLY_INVALID, "corrupt header does not widen the index range");
+    *ring.header = saved;
+
+    fill_slot(slot, PIPELINE_LINE, 0, WIDTH, HEIGHT);
+    check(request(fd, index, reply) && reply == index, "daemon still serves after bad requests");
+    slot->state.store(SLOT_FREE, std::memory_order_release);
+}
+
+void test_partial_request(FrameRing& ring, int fd) {
+    int stalled = connect_daemon();
+    uint32_t index = (uint32_t) frame_ring_claim(ring, 0);
+    FrameSlot* slot = frame_ring_slot(ring, index);
+    fill_slot(slot, PIPELINE_LINE, 0, WIDTH, HEIGHT);
+
+    // Half a request, then stall --> other producers must still be served
+    unsigned char bytes[sizeof(uint32_t)];
+    std::memcpy(bytes, &index, sizeof(index));
+    send(stalled, bytes, 2, 0);
+
+    uint32_t other = (uint32_t) frame_ring_claim(ring, 0);
+    FrameSlot* other_slot = frame_ring_slot(ring, other);
+    fill_slot(other_slot, PIPELINE_LINE, 0, WIDTH, HEIGHT);
+    uint32_t reply;
+    check(request(fd, other, reply) && reply == other, "stalled producer does not block the others");
+    other_slot->state.store(SLOT_FREE, std::memory_order_release);
+
+    send(stalled, bytes + 2, 2, 0);
+    check(recv(stalled, &reply, sizeof(reply), MSG_WAITALL) == (ssize_t) sizeof(reply) && reply == index,
+          "request sent in two pieces is answered");
+    slot->state.store(SLOT_FREE, std::memory_order_release);
+    close(stalled);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <path to threshold_daemon>" << std::endl;
+        return -1;
+    }
+    daemon_path = argv[1];
+    signal(SIGPIPE, SIG_IGN);
+
+    pid_t pid = start_daemon(true);
+    FrameRing ring;
+    int fd = connect_daemon();
+    if (fd < 0 || !attach(ring)) {
+        std::cerr << "Failed to start " << daemon_path << std::endl;
+        kill(pid, SIGTERM);
+        return -1;
+    }
+
+    test_claim(ring);
+    test_pipelines(ring, fd);
+    test_invalid_requests(ring, fd);
+    test_partial_request(ring, fd);
+
+    // A second daemon must not take over the running one
+    check(wait_exit(start_daemon(false), 2000) > 0, "second daemon on the same name refuses to start");
+    uint32_t reply;
+    check(request(fd, 100000, reply) && reply == FRAME_RING_REPLY_INVALID, "first daemon still serves");
+    close(fd);
+    frame_ring_detach(ring);
+
+    // A crashed daemon leaves its segment behind, only --force clears it
+    kill(pid, SIGKILL);
+    wait_exit(pid, 2000);
+    check(wait_exit(start_daemon(false), 2000) > 0, "daemon refuses leftovers without --force");
+    pid = start_daemon(true);
+    fd = connect_daemon();
+    check(fd >= 0 && attach(ring), "--force restarts over leftovers");
+    if (fd >= 0) {
+        uint32_t index = (uint32_t) frame_ring_claim(ring, 0);
+        fill_slot(frame_ring_slot(ring, index), PIPELINE_LINE, 0, WIDTH, HEIGHT);
+        check(request(fd, index, reply) && reply == index, "restarted daemon serves");
+        close(fd);
+        frame_ring_detach(ring);
+    }
+
+    // Clean shutdown removes the segment and the socket
+    kill(pid, SIGTERM);
+    check(wait_exit(pid, 2000) == 0, "daemon exits cleanly on SIGTERM");
+    check(!frame_ring_attach(SHM_NAME, ring) && access(SOCKET_PATH, F_OK) != 0, "shutdown removes shm and socket");
+
+    if (failures) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "ok" << std::endl;
+    return 0;
+}
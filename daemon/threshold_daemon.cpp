@@ -0,0 +1,276 @@
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "../lib/threshold_context.h"
+#include "../lib/frame_ring.h"
+
+// Long running version of car / diffuse
+// --> producers put raw frames in the shared memory ring (see lib/frame_ring.h) and send the slot index over the socket
+// --> the daemon runs the requested pipeline on the slot and replies with the same index once the results are written
+// --> every buffer is allocated at startup for the maximum frame size, so frames are processed without allocating
+
+const int MAX_CLIENTS = 64;
+const int KMEANS_CLUSTERS = 2;
+const int KMEANS_MAX_ITERATIONS = 100;
+const double ZSCORE_THRESHOLD = 2.0;
+
+volatile sig_atomic_t running = 1;
+
+void stop(int) {
+    running = 0;
+}
+
+struct Pipelines {
+    ThresholdContext ctx;
+    std::vector<unsigned char> red_channel;
+    std::vector<unsigned char> green_channel;
+
+    // Masks go straight into the slot, so the context does not need its own mask buffer
+    Pipelines(int width, int height, int channels)
+        : ctx(width, height, channels, false),
+          red_channel((size_t) width * height),
+          green_channel((size_t) width * height) {}
+};
+
+// Request fields copied out of the slot once, the producer can still write to the shared memory while we work
+struct FrameRequest {
+    uint32_t pipeline;
+    uint32_t flags;
+    int width;
+    int height;
+    int channels;
+};
+
+// Otsu + k-means thresholds of the red and green channels, then black out everything but dark red / light green
+bool run_threshold(Pipelines& p, const FrameRequest& request, const unsigned char* image, unsigned char* mask, FrameResult& result) {
+    if (request.channels < 2)
+        return false;
+
+    long int N = (long int) request.width * request.height;
+
+    // Sorted so that k-means starts from the brightest pixels, like car does
+    extract_channel(image, N, request.channels, 0, p.red_channel.data());
+    extract_channel(image, N, request.channels, 1, p.green_channel.data());
+    sort_descending(p.red_channel.data(), N);
+    sort_descending(p.green_channel.data(), N);
+
+    result.otsu_red = otsu_threshold(p.ctx, p.red_channel.data(), N);
+    result.otsu_green = otsu_threshold(p.ctx, p.green_channel.data(), N);
+    result.kmeans_red = kmeans_threshold(p.ctx, p.red_channel.data(), N, KMEANS_CLUSTERS, KMEANS_MAX_ITERATIONS);
+    result.kmeans_green = kmeans_threshold(p.ctx, p.green_channel.data(), N, KMEANS_CLUSTERS, KMEANS_MAX_ITERATIONS);
+    if (result.otsu_red < 0 || result.otsu_green < 0 || result.kmeans_red < 0 || result.kmeans_green < 0)
+        return false;
+
+    int red_threshold = result.otsu_red;
+    int green_threshold = result.otsu_green;
+    if (request.flags & FLAG_KMEANS_MASK) {
+        red_threshold = result.kmeans_red;
+        green_threshold = result.kmeans_green;
+    }
+    mask_pixels_to(mask, image, N, request.channels, [&](const unsigned char* px) {
+        return px[0] < red_threshold && px[1] > green_threshold;
+    });
+    return true;
+}
+
+// Brightest point of each column, then a line through the ones that are not outliers
+bool run_line(Pipelines& p, const FrameRequest& request, const unsigned char* image, FrameResult& result) {
+    double slope, intercept;
+    if (!column_peaks(p.ctx, image, request.width, request.height, request.channels) ||
+        !fit_line(p.ctx, request.width, ZSCORE_THRESHOLD, slope, intercept))
+        return false;
+
+    result.slope = slope;
+    result.intercept = intercept;
+    result.n_filtered = p.ctx.n_filtered;
+    return true;
+}
+
+// Returns false if index does not name a slot that is ready to be processed
+bool process(Pipelines& p, const FrameRing& ring, uint32_t index) {
+    if (index >= ring.n_slots)
+        return false;
+
+    // Take the slot, so a repeated request for it or a producer that changes its state cannot race with us
+    FrameSlot* slot = frame_ring_slot(ring, index);
+    uint32_t expected = SLOT_READY;
+    if (!slot->state.compare_exchange_strong(expected, SLOT_PROCESSING, std::memory_order_acquire))
+        return false;
+
+    FrameRequest request;
+    request.pipeline = slot->pipeline;
+    request.flags = slot->flags;
+    request.width = slot->width;
+    request.height = slot->height;
+    request.channels = slot->channels;
+
+    FrameResult result;
+    std::memset(&result, 0, sizeof(result));
+    bool ok = false;
+    if (p.ctx.fits(request.width, request.height, request.channels)) {
+        const unsigned char* image = frame_ring_pixels(slot);
+        if (request.pipeline == PIPELINE_THRESHOLD)
+            ok = run_threshold(p, request, image, frame_ring_mask(ring, slot), result);
+        else if (request.pipeline == PIPELINE_LINE)
+            ok = run_line(p, request, image, result);
+    }
+    // Only publish if the slot is still ours, a producer that freed or reclaimed it mid frame gets nothing back
+    if (slot->state.load(std::memory_order_acquire) != SLOT_PROCESSING)
+        return true;
+    slot->result = result;
+    expected = SLOT_PROCESSING;
+    slot->state.compare_exchange_strong(expected, ok ? SLOT_DONE : SLOT_ERROR, std::memory_order_release);
+    return true;
+}
+
+// A producer connection --> requests are 4 byte slot indexes, which can arrive in pieces
+struct Client {
+    unsigned char request[sizeof(uint32_t)];
+    size_t received;
+};
+
+// Read whatever the producer has sent and answer every complete request
+// Returns false when the connection should be closed
+bool serve(Pipelines& p, const FrameRing& ring, int fd, Client& client) {
+    while (true) {
+        ssize_t n = recv(fd, client.request + client.received, sizeof(client.request) - client.received, 0);
+        if (n == 0)
+            return false;
+        if (n < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+        client.received += n;
+        if (client.received < sizeof(client.request))
+            continue;
+        client.received = 0;
+
+        uint32_t index;
+        std::memcpy(&index, client.request, sizeof(index));
+        uint32_t reply = process(p, ring, index) ? index : FRAME_RING_REPLY_INVALID;
+        // A producer that does not read its replies gets dropped rather than stalling everyone else
+        if (send(fd, &reply, sizeof(reply), 0) != (ssize_t) sizeof(reply))
+            return false;
+    }
+}
+
+int main(int argc, char** argv) {
+    // --force removes a shared memory segment / socket left behind by a daemon that did not shut down cleanly
+    bool force = argc > 1 && std::strcmp(argv[1], "--force") == 0;
+    if (force) {
+        argv++;
+        argc--;
+    }
+    if (argc < 5) {
+        std::cerr << "Usage: threshold_daemon [--force] <shm name> <socket path> <max width> <max height> [slots] [max channels]" << std::endl;
+        return -1;
+    }
+    const char* shm_name = argv[1];
+    const char* socket_path = argv[2];
+    int max_width = std::atoi(argv[3]);
+    int max_height = std::atoi(argv[4]);
+    int n_slots = argc > 5 ? std::atoi(argv[5]) : 4;
+    int max_channels = argc > 6 ? std::atoi(argv[6]) : 3;
+    if (max_width <= 0 || max_height <= 0 || n_slots <= 0 || max_channels <= 0) {
+        std::cerr << "Invalid frame size or slot count" << std::endl;
+        return -1;
+    }
+
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (std::strlen(socket_path) >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path too long" << std::endl;
+        return -1;
+    }
+    std::strcpy(addr.sun_path, socket_path);
+
+    if (force) {
+        shm_unlink(shm_name);
+        unlink(socket_path);
+    }
+
+    FrameRing ring;
+    if (!frame_ring_create(shm_name, n_slots, max_width, max_height, max_channels, ring)) {
+        std::cerr << "Failed to create shared memory " << shm_name << ": " << std::strerror(errno) << std::endl;
+        if (errno == EEXIST)
+            std::cerr << "Another daemon may be running, use --force if it is gone" << std::endl;
+        return -1;
+    }
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*) &addr, sizeof(addr)) != 0 || listen(listen_fd, MAX_CLIENTS) != 0) {
+        std::cerr << "Failed to listen on " << socket_path << ": " << std::strerror(errno) << std::endl;
+        frame_ring_detach(ring);
+        shm_unlink(shm_name);
+        return -1;
+    }
+
+    struct sigaction sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stop;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    Pipelines pipelines(max_width, max_height, max_channels);
+
+    std::cout << "Listening on " << socket_path << ", shared memory " << shm_name << " (" << n_slots << " slots of "
+              << max_width << "x" << max_height << "x" << max_channels << ")" << std::endl;
+
+    // fds[0] is the listening socket, the rest are producers (clients[i] goes with fds[i])
+    struct pollfd fds[MAX_CLIENTS + 1];
+    Client clients[MAX_CLIENTS + 1];
+    int n_fds = 1;
+    fds[0].fd = listen_fd;
+    fds[0].events = POLLIN;
+
+    while (running) {
+        if (poll(fds, n_fds, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "poll failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+
+        for (int i = n_fds - 1; i >= 1; --i) {
+            if (!fds[i].revents)
+                continue;
+
+            bool keep = (fds[i].revents & POLLIN) && serve(pipelines, ring, fds[i].fd, clients[i]);
+            if (!keep) {
+                close(fds[i].fd);
+                --n_fds;
+                fds[i] = fds[n_fds];
+                clients[i] = clients[n_fds];
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int client = accept(listen_fd, nullptr, nullptr);
+            // Non blocking, so a producer that sends half a request cannot stall the others
+            if (client >= 0 && n_fds <= MAX_CLIENTS && fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK) == 0) {
+                clients[n_fds].received = 0;
+                fds[n_fds].fd = client;
+                fds[n_fds].events = POLLIN;
+                fds[n_fds].revents = 0;
+                n_fds++;
+            } else if (client >= 0) {
+                close(client);
+            }
+        }
+    }
+
+    for (int i = 0; i < n_fds; ++i)
+        close(fds[i].fd);
+    unlink(socket_path);
+    frame_ring_detach(ring);
+    shm_unlink(shm_name);
+    return 0;
+}
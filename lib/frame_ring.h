@@ -0,0 +1,231 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Shared memory layout used between producers and threshold_daemon
+// --> one segment: a FrameRingHeader followed by n_slots slots of slot_stride bytes each
+// --> every slot is a FrameSlot followed by the raw pixels (max_width * max_height * max_channels bytes)
+// and the mask written back by the daemon (same size)
+// Protocol, over a Unix domain stream socket:
+// --> producer claims a slot by moving it from SLOT_FREE to SLOT_WRITING (frame_ring_claim), only the claiming
+// producer may touch it until it is SLOT_FREE again
+// --> producer writes pixels + request fields into slot i, sets state to SLOT_READY, sends i as a uint32_t
+// --> daemon moves the slot from SLOT_READY to SLOT_PROCESSING, runs the pipeline, fills in result (and the mask),
+// sets state to SLOT_DONE or SLOT_ERROR and replies with i
+// --> if i is out of range or the slot is not SLOT_READY the daemon leaves the slot alone and replies
+// FRAME_RING_REPLY_INVALID instead
+// --> producer reads the results and sets state back to SLOT_FREE
+// Several producers share the ring, each one claims whichever slot is free (a ring producer starts looking at n % n_slots)
+
+const uint32_t FRAME_RING_MAGIC = 0x4f545355; // "OTSU"
+const uint32_t FRAME_RING_VERSION = 1;
+
+enum SlotState : uint32_t {
+    SLOT_FREE = 0,
+    SLOT_READY = 1,
+    SLOT_DONE = 2,
+    SLOT_ERROR = 3,
+    SLOT_WRITING = 4,
+    SLOT_PROCESSING = 5
+};
+
+// Daemon reply for a request that does not name a SLOT_READY slot
+const uint32_t FRAME_RING_REPLY_INVALID = 0xffffffffu;
+
+enum Pipeline : uint32_t {
+    // Task 2: Otsu + k-means thresholds on the red and green channels, dark red / light green mask
+    PIPELINE_THRESHOLD = 0,
+    // Task 1: brightest point of each column + linear regression through them
+    PIPELINE_LINE = 1
+};
+
+// PIPELINE_THRESHOLD: build the mask from the k-means thresholds instead of the Otsu ones
+const uint32_t FLAG_KMEANS_MASK = 1u << 0;
+
+struct FrameResult {
+    int32_t otsu_red;
+    int32_t otsu_green;
+    int32_t kmeans_red;
+    int32_t kmeans_green;
+    double slope;
+    double intercept;
+    int32_t n_filtered; // columns kept by the z-score filter
+};
+
+struct FrameSlot {
+    std::atomic<uint32_t> state;
+    // Request, filled in by the producer
+    uint32_t pipeline;
+    uint32_t flags;
+    int32_t width;
+    int32_t height;
+    int32_t channels;
+    uint64_t sequence;
+    // Response, filled in by the daemon
+    FrameResult result;
+};
+
+struct FrameRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t n_slots;
+    uint32_t max_width;
+    uint32_t max_height;
+    uint32_t max_channels;
+    uint64_t slot_stride;
+};
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "slot state must be lock free to live in shared memory");
+
+inline size_t frame_ring_align(size_t n) {
+    return (n + 63) & ~(size_t) 63;
+}
+
+inline size_t frame_ring_frame_bytes(uint32_t max_width, uint32_t max_height, uint32_t max_channels) {
+    return (size_t) max_width * max_height * max_channels;
+}
+
+inline size_t frame_ring_slot_stride(uint32_t max_width, uint32_t max_height, uint32_t max_channels) {
+    return frame_ring_align(sizeof(FrameSlot)) +
+           2 * frame_ring_align(frame_ring_frame_bytes(max_width, max_height, max_channels));
+}
+
+inline size_t frame_ring_size(uint32_t n_slots, uint32_t max_width, uint32_t max_height, uint32_t max_channels) {
+    return frame_ring_align(sizeof(FrameRingHeader)) +
+           (size_t) n_slots * frame_ring_slot_stride(max_width, max_height, max_channels);
+}
+
+// Geometry of a mapped segment, copied into private memory by frame_ring_create / frame_ring_attach
+// --> the header lives in shared memory that every producer can write to, so it is only read once when mapping;
+// all addresses and bounds checks after that come from this copy
+struct FrameRing {
+    FrameRingHeader* header; // start of the mapping
+    size_t size;             // bytes mapped
+    uint32_t n_slots;
+    uint32_t max_width;
+    uint32_t max_height;
+    uint32_t max_channels;
+    size_t slot_stride;
+};
+
+inline FrameSlot* frame_ring_slot(const FrameRing& ring, uint32_t index) {
+    unsigned char* base = (unsigned char*) ring.header + frame_ring_align(sizeof(FrameRingHeader));
+    return (FrameSlot*) (base + (size_t) index * ring.slot_stride);
+}
+
+// Claim a free slot for writing, looking at start first and then the ones after it
+// Returns the slot index, or -1 if every slot is in use
+inline long int frame_ring_claim(const FrameRing& ring, uint32_t start) {
+    for (uint32_t i = 0; i < ring.n_slots; ++i) {
+        uint32_t index = (start + i) % ring.n_slots;
+        uint32_t expected = SLOT_FREE;
+        if (frame_ring_slot(ring, index)->state.compare_exchange_strong(expected, SLOT_WRITING, std::memory_order_acquire))
+            return index;
+    }
+    return -1;
+}
+
+inline unsigned char* frame_ring_pixels(FrameSlot* slot) {
+    return (unsigned char*) slot + frame_ring_align(sizeof(FrameSlot));
+}
+
+inline unsigned char* frame_ring_mask(const FrameRing& ring, FrameSlot* slot) {
+    return frame_ring_pixels(slot) + frame_ring_align(frame_ring_frame_bytes(ring.max_width, ring.max_height, ring.max_channels));
+}
+
+// Create (daemon side) the shared segment and initialise the header and every slot
+// Fails if the name is already taken, so a second daemon cannot take over from a running one
+// Returns false on failure
+inline bool frame_ring_create(const char* name, uint32_t n_slots, uint32_t max_width, uint32_t max_height, uint32_t max_channels, FrameRing& ring) {
+    size_t size = frame_ring_size(n_slots, max_width, max_height, max_channels);
+
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+        return false;
+    if (ftruncate(fd, (off_t) size) != 0) {
+        close(fd);
+        shm_unlink(name);
+        return false;
+    }
+    void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        shm_unlink(name);
+        return false;
+    }
+
+    ring.header = (FrameRingHeader*) addr;
+    ring.size = size;
+    ring.n_slots = n_slots;
+    ring.max_width = max_width;
+    ring.max_height = max_height;
+    ring.max_channels = max_channels;
+    ring.slot_stride = frame_ring_slot_stride(max_width, max_height, max_channels);
+
+    FrameRingHeader* header = ring.header;
+    header->n_slots = n_slots;
+    header->max_width = max_width;
+    header->max_height = max_height;
+    header->max_channels = max_channels;
+    header->slot_stride = ring.slot_stride;
+    for (uint32_t i = 0; i < n_slots; ++i) {
+        FrameSlot* slot = frame_ring_slot(ring, i);
+        new (&slot->state) std::atomic<uint32_t>(SLOT_FREE);
+    }
+    header->version = FRAME_RING_VERSION;
+    header->magic = FRAME_RING_MAGIC;
+    return true;
+}
+
+// Map (producer side) a segment created by the daemon
+// Returns false on failure or if the segment is not a frame ring of this version
+inline bool frame_ring_attach(const char* name, FrameRing& ring) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < frame_ring_align(sizeof(FrameRingHeader))) {
+        close(fd);
+        return false;
+    }
+    size_t size = (size_t) st.st_size;
+    void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+        return false;
+
+    // Copy the header once, then check the copy against what was actually mapped
+    FrameRingHeader header = *(FrameRingHeader*) addr;
+    size_t stride = frame_ring_slot_stride(header.max_width, header.max_height, header.max_channels);
+    size_t available = size - frame_ring_align(sizeof(FrameRingHeader));
+    if (header.magic != FRAME_RING_MAGIC || header.version != FRAME_RING_VERSION ||
+        header.n_slots == 0 || stride != header.slot_stride || stride > available || header.n_slots > available / stride) {
+        munmap(addr, size);
+        return false;
+    }
+
+    ring.header = (FrameRingHeader*) addr;
+    ring.size = size;
+    ring.n_slots = header.n_slots;
+    ring.max_width = header.max_width;
+    ring.max_height = header.max_height;
+    ring.max_channels = header.max_channels;
+    ring.slot_stride = stride;
+    return true;
+}
+
+inline void frame_ring_detach(FrameRing& ring) {
+    munmap(ring.header, ring.size);
+    ring.header = nullptr;
+}
+
+#endif
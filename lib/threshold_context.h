@@ -0,0 +1,319 @@
+#ifndef THRESHOLD_CONTEXT_H
+#define THRESHOLD_CONTEXT_H
+
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+// Otsu / k-means / masking / line fitting as a library.
+// --> a ThresholdContext is created once for the largest frame it will ever see, and owns every scratch buffer
+// --> all the functions below only read and write into the context (or caller owned buffers), so once the
+// context exists, repeated calls never touch the heap
+// --> functions return -1 (or false) when the frame does not fit the context instead of growing it
+
+const int MAX_INTENSITY_LEVELS = 256;
+const int KMEANS_MAX_CLUSTERS = 8;
+
+struct ClusterStats {
+    int intensity; // average intensity of the pixels in the cluster
+    long int count;
+    int min_intensity;
+    int max_intensity;
+};
+
+struct ThresholdContext {
+    int max_width;
+    int max_height;
+    int max_channels;
+
+    // Otsu
+    long int hist[MAX_INTENSITY_LEVELS];
+
+    // K-means --> one cluster index per pixel
+    std::vector<unsigned char> assignments;
+    int centroids[KMEANS_MAX_CLUSTERS];
+    ClusterStats clusters[KMEANS_MAX_CLUSTERS];
+    long long cluster_total_intensity[KMEANS_MAX_CLUSTERS];
+
+    // Masking output, same layout as the input image (empty if the context was made without one)
+    std::vector<unsigned char> mask;
+
+    // Line fitting --> brightest value of each column and the average y where it occurs
+    std::vector<int> peak_intensity;
+    std::vector<int> peak_y;
+    // Columns that survive the z-score filter
+    std::vector<double> filtered_x;
+    std::vector<double> filtered_y;
+    int n_filtered;
+
+    // with_mask = false skips the mask buffer, for callers that only use mask_pixels_to
+    ThresholdContext(int width, int height, int channels, bool with_mask = true)
+        : max_width(width), max_height(height), max_channels(channels),
+          assignments((size_t) width * height),
+          mask(with_mask ? (size_t) width * height * channels : 0),
+          peak_intensity(width), peak_y(width),
+          filtered_x(width), filtered_y(width),
+          n_filtered(0) {}
+
+    long int max_pixels() const { return (long int) max_width * max_height; }
+
+    bool fits(int width, int height, int channels) const {
+        return width > 0 && height > 0 && channels > 0 &&
+               width <= max_width && (long int) width * height <= max_pixels() &&
+               channels <= max_channels;
+    }
+};
+
+// Copy one channel of an interleaved image into out (n_pixels bytes)
+inline void extract_channel(const unsigned char* image, long int n_pixels, int channels, int channel, unsigned char* out) {
+    for (long int i = 0; i < n_pixels; ++i) {
+        out[i] = image[i * channels + channel];
+    }
+}
+
+// Sort single channel intensities in descending order, in place
+// --> counting sort, so it needs no scratch memory beyond a histogram on the stack
+inline void sort_descending(unsigned char* pixels, long int N) {
+    long int counts[MAX_INTENSITY_LEVELS] = {0};
+    for (long int i = 0; i < N; ++i)
+        counts[pixels[i]]++;
+
+    long int pos = 0;
+    for (int v = MAX_INTENSITY_LEVELS - 1; v >= 0; --v) {
+        for (long int j = 0; j < counts[v]; ++j)
+            pixels[pos++] = (unsigned char) v;
+    }
+}
+
+// Maximize variance between classes, by iterating over each part of the intensity histogram
+// find intensity value that acts as a threshold to maximize variance between the two classes
+inline int otsu_threshold(ThresholdContext& ctx, const unsigned char* pixels, long int N) {
+    if (N <= 0 || N > ctx.max_pixels())
+        return -1;
+
+    int threshold = 0;
+    float sum = 0;
+    float sumB = 0;
+    long int q1 = 0;
+    long int q2 = 0;
+    float varMax = 0;
+
+    // Compute histogram
+    for (int i = 0; i < MAX_INTENSITY_LEVELS; i++)
+        ctx.hist[i] = 0;
+    for (long int i = 0; i < N; i++)
+        ctx.hist[pixels[i]]++;
+
+    // Auxiliary value for computing m2
+    for (int i = 0; i < MAX_INTENSITY_LEVELS; i++)
+        sum += (long long) i * ctx.hist[i];
+
+    for (int i = 0; i < MAX_INTENSITY_LEVELS; i++) {
+        q1 += ctx.hist[i]; // pixels up till i hist distribution
+        if (q1 == 0)
+            continue;
+        q2 = N - q1; // rest of the pixels
+        if (q2 == 0) // go until you cover whole histogram
+            break;
+
+        sumB += (float) ((long long) i * ctx.hist[i]);
+        float m1 = sumB / q1;
+        float m2 = (sum - sumB) / q2;
+
+        // Update the between class variance
+        float varBetween = (float) q1 * (float) q2 * (m1 - m2) * (m1 - m2);
+        if (varBetween > varMax) {
+            varMax = varBetween;
+            threshold = i;
+        }
+    }
+    return threshold;
+}
+
+// K-means on single channel intensities
+// --> centroids start at the first k pixels (the beginning of the sorted image for better convergence)
+// --> assign each pixel to the nearest centroid, then move each centroid to the average intensity of its pixels
+// --> stop after max_iterations or as soon as no centroid moves
+// --> afterwards fill ctx.clusters with the stats of each cluster
+// Returns the threshold used for masking: the largest of the per-cluster minimum intensities
+inline int kmeans_threshold(ThresholdContext& ctx, const unsigned char* pixels, long int N, int k, int max_iterations) {
+    if (N <= 0 || N > ctx.max_pixels() || k <= 0 || k > KMEANS_MAX_CLUSTERS || k > N)
+        return -1;
+
+    long int points_in_cluster[KMEANS_MAX_CLUSTERS];
+
+    for (int c = 0; c < k; ++c)
+        ctx.centroids[c] = pixels[c];
+
+    for (int iter = 0; iter < max_iterations; ++iter) {
+        for (int c = 0; c < k; ++c) {
+            points_in_cluster[c] = 0;
+            ctx.cluster_total_intensity[c] = 0;
+        }
+
+        // Assign points to nearest centroid
+        for (long int i = 0; i < N; ++i) {
+            int min_dist = std::abs(pixels[i] - ctx.centroids[0]);
+            int cluster_index = 0;
+            for (int c = 1; c < k; ++c) {
+                int dist = std::abs(pixels[i] - ctx.centroids[c]);
+                if (dist < min_dist) {
+                    min_dist = dist;
+                    cluster_index = c;
+                }
+            }
+            ctx.assignments[i] = (unsigned char) cluster_index;
+            points_in_cluster[cluster_index]++;
+            ctx.cluster_total_intensity[cluster_index] += pixels[i];
+        }
+
+        // Update centroids
+        bool moved = false;
+        for (int c = 0; c < k; ++c) {
+            if (points_in_cluster[c] > 0) {
+                int centroid = (int) (ctx.cluster_total_intensity[c] / points_in_cluster[c]);
+                moved = moved || centroid != ctx.centroids[c];
+                ctx.centroids[c] = centroid;
+            }
+        }
+        // Converged --> further passes would repeat this one exactly
+        if (!moved)
+            break;
+    }
+
+    // Cluster stats
+    for (int c = 0; c < k; ++c) {
+        ctx.clusters[c].count = 0;
+        ctx.clusters[c].min_intensity = std::numeric_limits<int>::max();
+        ctx.clusters[c].max_intensity = std::numeric_limits<int>::min();
+        ctx.cluster_total_intensity[c] = 0;
+    }
+    for (long int i = 0; i < N; ++i) {
+        ClusterStats& stats = ctx.clusters[ctx.assignments[i]];
+        stats.count++;
+        ctx.cluster_total_intensity[ctx.assignments[i]] += pixels[i];
+        if (pixels[i] < stats.min_intensity)
+            stats.min_intensity = pixels[i];
+        if (pixels[i] > stats.max_intensity)
+            stats.max_intensity = pixels[i];
+    }
+
+    int threshold = -1;
+    for (int c = 0; c < k; ++c) {
+        ClusterStats& stats = ctx.clusters[c];
+        if (stats.count > 0) {
+            stats.intensity = (int) (ctx.cluster_total_intensity[c] / stats.count);
+        } else {
+            stats.intensity = 0;
+            stats.min_intensity = 0;
+            stats.max_intensity = 0;
+        }
+        if (stats.min_intensity > threshold)
+            threshold = stats.min_intensity;
+    }
+    return threshold;
+}
+
+// Black out every pixel for which keep(pixel) is false, writing the result into out
+// keep gets a pointer to the first channel of the pixel
+template <typename Keep>
+void mask_pixels_to(unsigned char* out, const unsigned char* image, long int N, int channels, Keep keep) {
+    for (long int i = 0; i < N; ++i) {
+        const unsigned char* pixel = image + i * channels;
+        bool kept = keep(pixel);
+        for (int c = 0; c < channels; ++c)
+            out[i * channels + c] = kept ? pixel[c] : 0;
+    }
+}
+
+// Same as mask_pixels_to, with the result in ctx.mask
+template <typename Keep>
+bool mask_pixels(ThresholdContext& ctx, const unsigned char* image, int width, int height, int channels, Keep keep) {
+    if (!ctx.fits(width, height, channels) || ctx.mask.size() < (size_t) width * height * channels)
+        return false;
+
+    mask_pixels_to(ctx.mask.data(), image, (long int) width * height, channels, keep);
+    return true;
+}
+
+// For each column find the max intensity (first channel) and the average y value where it occurs
+inline bool column_peaks(ThresholdContext& ctx, const unsigned char* image, int width, int height, int channels) {
+    if (!ctx.fits(width, height, channels))
+        return false;
+
+    for (int x = 0; x < width; ++x) {
+        int max_intensity = 0;
+        for (int y = 0; y < height; ++y) {
+            int value = image[((long int) y * width + x) * channels];
+            if (max_intensity < value)
+                max_intensity = value;
+        }
+
+        long long sum = 0;
+        long int divisor = 0;
+        for (int y = 0; y < height; ++y) {
+            if (image[((long int) y * width + x) * channels] == max_intensity) {
+                sum += y;
+                divisor++;
+            }
+        }
+        ctx.peak_intensity[x] = max_intensity;
+        ctx.peak_y[x] = (int) (sum / divisor);
+    }
+    return true;
+}
+
+// Linear regression of peak_y against the column index over the first n columns of the context
+// --> columns whose peak intensity has a z-score above zscore_threshold are dropped as outliers
+// --> surviving points are left in ctx.filtered_x / ctx.filtered_y (ctx.n_filtered of them)
+// m = (nExy - ExEy)/(nEx^2-(Ex)^2)
+// Returns false (slope and intercept untouched) when fewer than 2 usable points are left
+inline bool fit_line(ThresholdContext& ctx, int n, double zscore_threshold, double& slope, double& intercept) {
+    if (n <= 0 || n > ctx.max_width)
+        return false;
+
+    // average intensity
+    double y_mean_intensity = 0.0;
+    for (int i = 0; i < n; i++)
+        y_mean_intensity += ctx.peak_intensity[i];
+    y_mean_intensity /= n;
+
+    // S = sqrt((E(x-mu)^2)/n)
+    double y_stddev = 0.0;
+    for (int i = 0; i < n; i++)
+        y_stddev += (ctx.peak_intensity[i] - y_mean_intensity) * (ctx.peak_intensity[i] - y_mean_intensity);
+    y_stddev = std::sqrt(y_stddev / n);
+
+    // Filter data points based on z-scores, z = (x - mu)/stdev
+    // --> with no spread in intensity (blank or saturated frame) there are no outliers, keep every column
+    ctx.n_filtered = 0;
+    for (int i = 0; i < n; ++i) {
+        bool keep = y_stddev == 0.0 || std::abs((ctx.peak_intensity[i] - y_mean_intensity) / y_stddev) <= zscore_threshold;
+        if (keep) {
+            ctx.filtered_x[ctx.n_filtered] = i;
+            ctx.filtered_y[ctx.n_filtered] = ctx.peak_y[i];
+            ctx.n_filtered++;
+        }
+    }
+
+    int m = ctx.n_filtered;
+    double sum_x = 0.0, sum_y = 0.0, sum_xy = 0.0, sum_x2 = 0.0;
+    for (int i = 0; i < m; ++i) {
+        sum_x += ctx.filtered_x[i];
+        sum_y += ctx.filtered_y[i];
+        sum_xy += ctx.filtered_x[i] * ctx.filtered_y[i];
+        sum_x2 += ctx.filtered_x[i] * ctx.filtered_x[i];
+    }
+
+    // A line needs at least 2 points with different x
+    double denominator = m * sum_x2 - sum_x * sum_x;
+    if (m < 2 || denominator == 0.0)
+        return false;
+
+    slope = (m * sum_xy - sum_x * sum_y) / denominator;
+    intercept = (sum_y - slope * sum_x) / m;
+    return true;
+}
+
+#endif